@@ -0,0 +1,219 @@
+#!/bin/bash
+
+# Build, publish and fetch the prebuilt per-chip HAL static libraries.
+#
+# The sync script sources this file to publish the libraries of each sync head.
+# Downstream projects (e.g. NuttX) can run it directly to fetch them:
+#
+#   ARTIFACT_STORE=<store> tools/artifacts.sh fetch SYNC_SHA CHIP DEST [SDKCONFIG_DEFAULTS]
+#
+# It returns non-zero on a cache miss, so the caller can fall back to building
+# from sources.
+#
+# ARTIFACT_STORE is either a local directory (or file:// URL), or an HTTP(S) URL
+# laid out like a GitLab generic package registry: <store>/<package>/<version>/<file>
+
+HAL_ARTIFACT_COMPONENTS="hal soc esp_hw_support esp_rom efuse spi_flash log"
+HAL_ARTIFACT_CHIPS=${HAL_ARTIFACT_CHIPS:-"esp32 esp32s2 esp32s3 esp32c2 esp32c3 esp32c6 esp32h2"}
+
+ARTIFACTS_TOOLS_DIR=$(dirname "$(realpath "${BASH_SOURCE[0]}")")
+
+# Hash of the sdkconfig defaults the libraries are built with. The order of the
+# options and the comments don't change the hash.
+# Usage: config_hash [SDKCONFIG_DEFAULTS]
+config_hash() {
+    # Hashing nothing would silently match the stock defaults
+    if [ -n "$1" ] && [ ! -r "$1" ]; then
+        echo "Can't read sdkconfig defaults $1" >&2
+        return 1
+    fi
+
+    if [ -n "$1" ]; then
+        sed -e '/^[[:space:]]*#/d' -e '/^[[:space:]]*$/d' "$1" | sort
+    fi | sha256sum | cut -c1-12
+}
+
+# Usage: hal_artifact_path SYNC_SHA CHIP CONFIG_HASH
+hal_artifact_path() {
+    echo "hal-${2}/${1}-${3}/hal-${2}.tar.gz"
+}
+
+# Usage: store_put FILE PATH
+store_put() {
+    case "${ARTIFACT_STORE}" in
+        "")
+            echo "ARTIFACT_STORE is not set, can't publish $2" >&2
+            return 1
+            ;;
+        http://*|https://*)
+            curl --fail --silent --show-error \
+                 --header "JOB-TOKEN: ${CI_JOB_TOKEN}" \
+                 --upload-file "$1" "${ARTIFACT_STORE}/$2"
+            ;;
+        *)
+            mkdir -p "$(dirname "${ARTIFACT_STORE#file://}/$2")"
+            cp "$1" "${ARTIFACT_STORE#file://}/$2"
+            ;;
+    esac
+}
+
+# Usage: store_get PATH FILE
+store_get() {
+    case "${ARTIFACT_STORE}" in
+        "")
+            return 1
+            ;;
+        http://*|https://*)
+            AUTH_HEADER=()
+            if [ -n "${CI_JOB_TOKEN}" ]; then
+                AUTH_HEADER=(--header "JOB-TOKEN: ${CI_JOB_TOKEN}")
+            fi
+            curl --fail --silent --location "${AUTH_HEADER[@]}" \
+                 --output "$2" "${ARTIFACT_STORE}/$1"
+            ;;
+        *)
+            cp "${ARTIFACT_STORE#file://}/$1" "$2" 2> /dev/null
+            ;;
+    esac
+}
+
+# Create a minimal IDF project requiring the given components.
+# PROJECT_COMPILE_OPTIONS, if set, is added to the compile options of every component.
+# Usage: mkproject PROJECT_DIR COMPONENTS...
+mkproject() {
+    mkdir -p "$1/main"
+
+    cat > "$1/CMakeLists.txt" << EOF
+cmake_minimum_required(VERSION 3.16)
+set(COMPONENTS main)
+include(\$ENV{IDF_PATH}/tools/cmake/project.cmake)
+EOF
+
+    for OPTION in ${PROJECT_COMPILE_OPTIONS}
+    do
+        echo "idf_build_set_property(COMPILE_OPTIONS \"${OPTION}\" APPEND)" >> "$1/CMakeLists.txt"
+    done
+
+    echo "project(esp_hal_3rdparty)" >> "$1/CMakeLists.txt"
+
+    echo "idf_component_register(SRCS \"main.c\" REQUIRES ${*:2})" > "$1/main/CMakeLists.txt"
+    echo "void app_main(void) {}" > "$1/main/main.c"
+
+    if [ -n "${HAL_ARTIFACT_SDKCONFIG}" ]; then
+        cp "${HAL_ARTIFACT_SDKCONFIG}" "$1/sdkconfig.defaults"
+    fi
+}
+
+# Usage: idf_build IDF_PATH PROJECT_DIR CHIP
+idf_build() {
+    (
+        export IDF_PATH=$1
+        "${IDF_PATH}/install.sh" "$3" > /dev/null &&
+        . "${IDF_PATH}/export.sh" > /dev/null &&
+        idf.py -C "$2" -B "$2/build" set-target "$3" &&
+        idf.py -C "$2" -B "$2/build" build
+    )
+}
+
+# Copy the libraries and the public headers of the HAL components out of a build.
+# Usage: collect_hal_artifacts BUILD_DIR DEST
+collect_hal_artifacts() {
+    mkdir -p "$2/lib" "$2/include" &&
+    cp "$1/config/sdkconfig.h" "$2/include/" &&
+    cp "$1/../sdkconfig" "$2/" &&
+
+    python3 - "$1/project_description.json" "$2" ${HAL_ARTIFACT_COMPONENTS} << EOF
+import json, os, shutil, sys
+
+desc, dest, components = sys.argv[1], sys.argv[2], sys.argv[3:]
+info = json.load(open(desc))['build_component_info']
+
+for name in components:
+    shutil.copy(info[name]['file'], os.path.join(dest, 'lib'))
+    for inc in info[name]['include_dirs']:
+        shutil.copytree(os.path.join(info[name]['dir'], inc),
+                        os.path.join(dest, 'include', name, inc),
+                        dirs_exist_ok=True)
+EOF
+}
+
+# Build the HAL libraries of one chip in WORK_DIR and publish them.
+# Usage: build_chip_hal_artifacts IDF_PATH SYNC_SHA CHIP WORK_DIR
+build_chip_hal_artifacts() {
+    CFG_HASH=$(config_hash "${HAL_ARTIFACT_SDKCONFIG}") &&
+    IDF_SHA=$(git -C "$1" rev-parse HEAD) &&
+
+    mkproject "$4/project" ${HAL_ARTIFACT_COMPONENTS} &&
+    idf_build "$1" "$4/project" "$3" &&
+    collect_hal_artifacts "$4/project/build" "$4/hal-$3" &&
+
+    # Compare the unity build of hal and soc with the per-file one
+    {
+        python3 "${ARTIFACTS_TOOLS_DIR}/gen_unity_build.py" --root "$1" --chip "$3" \
+            --output "$4/unity" --measure \
+            --compile-commands "$4/project/build/compile_commands.json" \
+            > "$4/hal-$3/unity_report.txt" || echo "Failed to measure the unity build for $3"
+    } &&
+
+    {
+        echo "sync_sha: $2"
+        echo "idf_sha: ${IDF_SHA}"
+        echo "chip: $3"
+        echo "config_hash: ${CFG_HASH}"
+    } > "$4/hal-$3/info.txt" &&
+
+    tar -C "$4" -czf "$4/hal-$3.tar.gz" "hal-$3" &&
+    store_put "$4/hal-$3.tar.gz" "$(hal_artifact_path "$2" "$3" "${CFG_HASH}")"
+}
+
+# Build the HAL libraries of every chip and publish them keyed by the sync SHA.
+# A chip failing to build or to publish doesn't prevent the others.
+# Usage: build_hal_artifacts IDF_PATH SYNC_SHA
+build_hal_artifacts() {
+    if [ -z "${ARTIFACT_STORE}" ]; then
+        echo "ARTIFACT_STORE is not set, not building the HAL artifacts"
+        return 0
+    fi
+
+    for CHIP in ${HAL_ARTIFACT_CHIPS}
+    do
+        WORK_DIR=$(mktemp -d)
+        build_chip_hal_artifacts "$1" "$2" "${CHIP}" "${WORK_DIR}" || \
+            echo "Failed to build or publish the HAL artifacts for ${CHIP}, skipping"
+        rm -rf "${WORK_DIR}"
+    done
+}
+
+# Usage: fetch_hal_artifacts SYNC_SHA CHIP DEST [SDKCONFIG_DEFAULTS]
+fetch_hal_artifacts() {
+    CFG_HASH=$(config_hash "$4") || return 1
+    ARCHIVE=$(mktemp)
+
+    if ! store_get "$(hal_artifact_path "$1" "$2" "${CFG_HASH}")" "${ARCHIVE}"; then
+        rm -f "${ARCHIVE}"
+        echo "No prebuilt HAL for ${2} at ${1}, build it from sources" >&2
+        return 1
+    fi
+
+    mkdir -p "$3"
+    tar -C "$3" --strip-components=1 -xzf "${ARCHIVE}"
+    rm -f "${ARCHIVE}"
+}
+
+if [ "${BASH_SOURCE[0]}" == "$0" ]; then
+    set -e
+
+    case "$1" in
+        fetch)
+            fetch_hal_artifacts "${@:2}"
+            ;;
+        config-hash)
+            config_hash "$2"
+            ;;
+        *)
+            echo "Usage: $0 fetch SYNC_SHA CHIP DEST [SDKCONFIG_DEFAULTS]" >&2
+            echo "       $0 config-hash [SDKCONFIG_DEFAULTS]" >&2
+            exit 1
+            ;;
+    esac
+fi
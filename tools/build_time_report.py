@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+
+"""
+Aggregate the clang -ftime-trace files of an IDF build directory.
+
+Reports the compile time per component and per translation unit, the parsing
+time and fan-out (number of translation units including it) of each header,
+and the include chains with the highest total cost leading to the headers
+matching --focus (e.g. the soc register structs).
+"""
+
+import argparse
+import fnmatch
+import json
+import os
+import re
+import sys
+from collections import defaultdict
+
+
+def short_path(path):
+    path = os.path.normpath(path)
+    idx = path.rfind('/components/')
+    if idx >= 0:
+        return path[idx + len('/components/'):]
+    return path
+
+
+def component_of(trace_file, build_dir):
+    rel = os.path.relpath(trace_file, os.path.join(build_dir, 'esp-idf'))
+    return rel.split(os.sep)[0]
+
+
+def load_trace(trace_file):
+    with open(trace_file) as f:
+        try:
+            data = json.load(f)
+        except ValueError:
+            return None
+    if not isinstance(data, dict) or 'traceEvents' not in data:
+        return None
+    return data['traceEvents']
+
+
+def parse_trace(events):
+    """Return (compile time, [(include chain, inclusive time)]) of one translation unit, in us."""
+    total = 0
+    sources = []
+    for ev in events:
+        if ev.get('ph') != 'X':
+            continue
+        if ev.get('name') == 'ExecuteCompiler':
+            total += ev['dur']
+        elif ev.get('name') == 'Source':
+            sources.append((ev['ts'], ev['dur'], short_path(ev['args']['detail'])))
+
+    # Source events of nested includes are contained in the one of their includer
+    sources.sort(key=lambda s: (s[0], -s[1]))
+    stack = []
+    chains = []
+    for ts, dur, path in sources:
+        while stack and stack[-1][0] <= ts:
+            stack.pop()
+        chain = tuple(s[1] for s in stack) + (path,)
+        stack.append((ts + dur, path))
+        chains.append((chain, dur))
+    return total, chains
+
+
+def collect(build_dir, focus):
+    components = defaultdict(lambda: {'units': 0, 'time': 0})
+    units = []
+    headers = defaultdict(lambda: {'units': set(), 'time': 0})
+    focus_chains = defaultdict(lambda: {'count': 0, 'time': 0})
+
+    for root, _, files in os.walk(os.path.join(build_dir, 'esp-idf')):
+        for name in files:
+            if not name.endswith('.json'):
+                continue
+            trace_file = os.path.join(root, name)
+            events = load_trace(trace_file)
+            if events is None:
+                continue
+
+            unit = re.sub(r'(\.obj)?\.json$', '', os.path.relpath(trace_file, build_dir))
+            total, chains = parse_trace(events)
+
+            component = components[component_of(trace_file, build_dir)]
+            component['units'] += 1
+            component['time'] += total
+            units.append((unit, total))
+
+            for chain, dur in chains:
+                headers[chain[-1]]['units'].add(unit)
+                headers[chain[-1]]['time'] += dur
+                if any(fnmatch.fnmatch(chain[-1], pattern) for pattern in focus):
+                    focus_chains[chain]['count'] += 1
+                    focus_chains[chain]['time'] += dur
+
+    return components, units, headers, focus_chains
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('build_dir', help='IDF build directory compiled with -ftime-trace')
+    parser.add_argument('--focus', action='append', default=None,
+                        help='Glob of the headers to report include chains for (default: *_struct.h)')
+    parser.add_argument('--top', type=int, default=20, help='Number of entries per table')
+    parser.add_argument('--json', help='Also write the full results to this file')
+    args = parser.parse_args()
+    focus = args.focus or ['*_struct.h']
+
+    components, units, headers, focus_chains = collect(args.build_dir, focus)
+    if not units:
+        sys.exit('No -ftime-trace files found in ' + args.build_dir)
+
+    def ms(us):
+        return us / 1000.0
+
+    print('== Compile time per component ==')
+    for name, c in sorted(components.items(), key=lambda i: -i[1]['time']):
+        print('%10.1f ms %5d TUs  %s' % (ms(c['time']), c['units'], name))
+
+    print('\n== Slowest translation units ==')
+    for unit, total in sorted(units, key=lambda u: -u[1])[:args.top]:
+        print('%10.1f ms  %s' % (ms(total), unit))
+
+    print('\n== Headers by total parsing time ==')
+    for path, h in sorted(headers.items(), key=lambda i: -i[1]['time'])[:args.top]:
+        print('%10.1f ms %5d TUs  %s' % (ms(h['time']), len(h['units']), path))
+
+    print('\n== Worst include chains to %s ==' % ', '.join(focus))
+    for chain, c in sorted(focus_chains.items(), key=lambda i: -i[1]['time'])[:args.top]:
+        print('%10.1f ms %5d TUs  %s' % (ms(c['time']), c['count'], ' -> '.join(chain)))
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({
+                'components': components,
+                'units': dict(units),
+                'headers': {p: {'units': len(h['units']), 'time': h['time']} for p, h in headers.items()},
+                'chains': [{'chain': list(chain), 'units': c['count'], 'time': c['time']}
+                           for chain, c in sorted(focus_chains.items(), key=lambda i: -i[1]['time'])],
+            }, f, indent=2)
+
+
+if __name__ == '__main__':
+    main()
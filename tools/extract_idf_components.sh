@@ -2,10 +2,22 @@
 
 set -ex
 
+TOOLS_DIR=$(dirname "$(realpath "$0")")
+
+. "${TOOLS_DIR}/artifacts.sh"
+
 # If the pipeline is running from a branch different from project's default
 # add a suffix to push sync branch
 if [ "${CI_COMMIT_BRANCH}" != "${CI_DEFAULT_BRANCH}" ]; then
     DEBUG_SUFFIX="-debug"
+
+    # The sync SHAs don't depend on the suffix, don't overwrite the published artifacts
+    unset ARTIFACT_STORE
+fi
+
+# The builds run from within the IDF clones
+if [ -n "${HAL_ARTIFACT_SDKCONFIG}" ]; then
+    HAL_ARTIFACT_SDKCONFIG=$(realpath "${HAL_ARTIFACT_SDKCONFIG}")
 fi
 
 # Usage: clone_idf ESP_IDF_BRANCH
@@ -13,6 +25,16 @@ clone_idf() {
     git clone --single-branch --branch "$1" "${IDF_URL}" .
 }
 
+# Create an unfiltered copy of the IDF clone, with submodules, to build from.
+# It has to be done before filtering, which rewrites the whole history.
+# Usage: prepare_build_tree BUILD_TREE
+prepare_build_tree() {
+    rm -rf $1
+    git clone --quiet . $1 &&
+    git -C $1 remote set-url origin "${IDF_URL}" &&
+    git -C $1 submodule update --init --recursive --depth 1
+}
+
 # Usage: find_pattern STRING
 find_pattern() {
     git --no-pager log -i --grep "$1" > issue_found.txt
@@ -27,6 +49,32 @@ check_links() {
     find_pattern 'espressif/esp-idf[!#$&~%^]'
 }
 
+# Usage: components_from_args ARGS...
+components_from_args() {
+    while [ $# -gt 0 ]
+    do
+        if [ "$1" == "--path" ] && [[ "$2" == components/* ]]; then
+            echo ${2#components/}
+        fi
+        shift
+    done
+}
+
+# Print the tree object hash of each component, and of each of its chip
+# subdirectories, at the given revision. Missing components are marked with '-'.
+# Usage: component_manifest REV COMPONENTS...
+component_manifest() {
+    for COMPONENT in ${@:2}
+    do
+        TREE=$(git rev-parse --verify --quiet "$1:components/${COMPONENT}") || TREE="-"
+        echo "${TREE} components/${COMPONENT}"
+
+        if [ "${TREE}" != "-" ]; then
+            git ls-tree -r -d "$1" "components/${COMPONENT}" | awk '$4 ~ /\/esp32[^\/]*$/ { print $3 " " $4 }'
+        fi
+    done
+}
+
 # Usage: extract_components ESP_IDF_BRANCH SYNC_BRANCH_NAME ARGS...
 extract_components() {
     ESP_IDF_BRANCH=$1
@@ -34,8 +82,11 @@ extract_components() {
     ARGS="${@:3}"
 
     FOLDER_NAME="esp-idf/${SYNC_BRANCH_NAME}"
+    BUILD_TREE="$(pwd)/${FOLDER_NAME}.build"
+    MANIFEST="$(pwd)/manifests/${SYNC_BRANCH_NAME//\//_}.txt"
+    REPORT_DIR="$(pwd)/reports/${SYNC_BRANCH_NAME//\//_}"
 
-    rm -rf ${FOLDER_NAME}
+    rm -rf ${FOLDER_NAME} ${BUILD_TREE}
     mkdir -p ${FOLDER_NAME}
 
     pushd ${FOLDER_NAME}
@@ -44,6 +95,16 @@ extract_components() {
 
     clone_idf "${ESP_IDF_BRANCH}"
 
+    # The builds are optional extras, they must not prevent the sync
+    BUILD_TREE_READY=""
+    if [ -n "${BUILD_HAL_ARTIFACTS}${PROFILE_BUILD_TIME}${TRACK_FOOTPRINT}" ]; then
+        if prepare_build_tree ${BUILD_TREE}; then
+            BUILD_TREE_READY="y"
+        else
+            echo "Failed to prepare the build tree of ${SYNC_BRANCH_NAME}, skipping the builds"
+        fi
+    fi
+
     echo "Extract to branch ${SYNC_BRANCH_NAME} with arg list: '$ARGS'"
 
     git filter-repo "${@:3}"
@@ -51,12 +112,49 @@ extract_components() {
     check_links
 
     git checkout -B ${SYNC_BRANCH_NAME}
+
+    SYNC_SHA=$(git rev-parse HEAD)
+
+    # Lets downstream builds skip the components that didn't change between two sync heads
+    mkdir -p $(dirname ${MANIFEST})
+    {
+        echo "# ${SYNC_BRANCH_NAME} ${SYNC_SHA}"
+        component_manifest ${SYNC_SHA} $(components_from_args "${@:3}")
+    } > ${MANIFEST}
+
     git push ${ESP_HAL_3RDPARTY_URL} ${SYNC_BRANCH_NAME} || {
         push_to_temporary_branch ${ESP_HAL_3RDPARTY_URL} ${SYNC_BRANCH_NAME}
         force_push_job "${SYNC_BRANCH_NAME}" >> ../force_push.yml
     }
+
+    # ARTIFACT_STORE is unset on debug pipelines
+    if [ -n "${ARTIFACT_STORE}" ]; then
+        store_put ${MANIFEST} components-manifest/${SYNC_SHA}/manifest.txt || \
+            echo "Failed to publish the manifest of ${SYNC_BRANCH_NAME}"
+    fi
+
+    if [ -n "${BUILD_TREE_READY}" ] && [ -n "${BUILD_HAL_ARTIFACTS}" ]; then
+        build_hal_artifacts ${BUILD_TREE} ${SYNC_SHA} || echo "Failed to build the HAL artifacts of ${SYNC_BRANCH_NAME}"
+    fi
+
+    if [ -n "${BUILD_TREE_READY}" ] && [ -n "${PROFILE_BUILD_TIME}" ]; then
+        ${TOOLS_DIR}/profile_build_time.sh ${BUILD_TREE} ${PROFILE_BUILD_TIME_CHIP} ${REPORT_DIR}/build-time \
+            $(components_from_args "${@:3}") || echo "Failed to profile the build time of ${SYNC_BRANCH_NAME}"
+
+        if [ -n "${ARTIFACT_STORE}" ] && [ -f ${REPORT_DIR}/build-time/report.json ]; then
+            store_put ${REPORT_DIR}/build-time/report.json build-time/${SYNC_SHA}/${PROFILE_BUILD_TIME_CHIP}.json || \
+                echo "Failed to publish the build time report of ${SYNC_BRANCH_NAME}"
+        fi
+    fi
+
+    if [ -n "${BUILD_TREE_READY}" ] && [ -n "${TRACK_FOOTPRINT}" ]; then
+        ${TOOLS_DIR}/track_footprint.sh ${BUILD_TREE} ${SYNC_BRANCH_NAME} ${SYNC_SHA} ${REPORT_DIR}/footprint \
+            $(components_from_args "${@:3}") || echo "Failed to track the footprint of ${SYNC_BRANCH_NAME}"
+    fi
+
     git clean -xdff
     popd
+    rm -rf ${BUILD_TREE}
 }
 
 # Create a temporary branch to store the branch to be pushed
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+
+"""
+Record the footprint of the synced components for one chip, and flag increases.
+
+The sizes are taken from the allocated sections of the static libraries: the
+prebuilt ones shipped with the components (found under a directory named after
+the chip, e.g. esp_wifi/lib/esp32c3) and the ones built from the component
+sources (from the project_description.json of an IDF build). Each section is
+counted as one of:
+
+  iram    sections placed in IRAM by attribute (.iram1.*, .wifi0iram.*, .phyiram.*, ...)
+  dram    .dram0.*, .dram1.*, .data*, .bss* and their small-data variants
+  rodata  .rodata*, .srodata*
+  text    the other executable sections, in flash
+
+Placement done by linker fragments isn't visible before linking, so the figures
+are meant to be compared across sync runs rather than with a linked image.
+
+The rows are appended to a CSV history. Components whose IRAM or flash
+(text + rodata) footprint grew by more than the threshold since the previous
+sync SHA of the same branch are reported.
+"""
+
+import argparse
+import csv
+import datetime
+import json
+import os
+import re
+import struct
+import sys
+
+FIELDS = ['date', 'branch', 'sync_sha', 'chip', 'component', 'kind', 'text', 'rodata', 'iram', 'dram']
+CATEGORIES = ['text', 'rodata', 'iram', 'dram']
+
+SHF_ALLOC = 0x2
+SHF_EXECINSTR = 0x4
+
+# Only match the section prefixes (.iram1, .wifi0iram, .phyiram, .coexsleepiram, ...):
+# with -ffunction-sections, a flash function named e.g. "load_iram" ends up in .text.load_iram
+IRAM_RE = re.compile(r'^\.\w*iram[01]?(\.|$)')
+DRAM_RE = re.compile(r'^\.dram[01](\.|$)')
+
+
+def category(name, flags):
+    if IRAM_RE.match(name):
+        return 'iram'
+    if DRAM_RE.match(name) or name.startswith(('.data', '.sdata', '.bss', '.sbss')):
+        return 'dram'
+    if name.startswith(('.rodata', '.srodata')):
+        return 'rodata'
+    if flags & SHF_EXECINSTR:
+        return 'text'
+    return None
+
+
+def elf_sections(data):
+    """Yield (name, flags, size) of the sections of an ELF object."""
+    is64 = data[4] == 2
+    endian = '<' if data[5] == 1 else '>'
+    if is64:
+        shoff, = struct.unpack_from(endian + 'Q', data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', data, 0x3a)
+        sh_fmt = endian + 'IIQQQQ'
+    else:
+        shoff, = struct.unpack_from(endian + 'I', data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', data, 0x2e)
+        sh_fmt = endian + 'IIIIII'
+
+    headers = [struct.unpack_from(sh_fmt, data, shoff + i * shentsize) for i in range(shnum)]
+    strtab = headers[shstrndx][4] if headers else 0
+    for name_off, _, flags, _, _, size in headers:
+        name = data[strtab + name_off:data.index(b'\0', strtab + name_off)].decode()
+        yield name, flags, size
+
+
+def archive_members(path):
+    """Yield the contents of the ELF members of an ar archive."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if not data.startswith(b'!<arch>\n'):
+        sys.exit('%s is not an archive' % path)
+    pos = 8
+    while pos + 60 <= len(data):
+        size = int(data[pos + 48:pos + 58])
+        member = data[pos + 60:pos + 60 + size]
+        if member.startswith(b'\x7fELF'):
+            yield member
+        pos += 60 + size + (size & 1)
+
+
+def library_size(paths):
+    sizes = dict.fromkeys(CATEGORIES, 0)
+    for path in paths:
+        for member in archive_members(path):
+            for name, flags, size in elf_sections(member):
+                cat = category(name, flags) if flags & SHF_ALLOC else None
+                if cat:
+                    sizes[cat] += size
+    return sizes
+
+
+def prebuilt_libraries(idf_path, component, chip):
+    libs = []
+    for root, _, files in os.walk(os.path.join(idf_path, 'components', component)):
+        parts = os.path.relpath(root, idf_path).split(os.sep)
+        if any(p == chip or p.startswith(chip + '-') for p in parts):
+            libs += [os.path.join(root, f) for f in files if f.endswith('.a')]
+    return sorted(libs)
+
+
+def read_history(path):
+    if not path or not os.path.exists(path):
+        return []
+    with open(path) as f:
+        return list(csv.DictReader(f))
+
+
+def previous_rows(history, branch, sync_sha, chip):
+    """Return the rows of the latest sync SHA before sync_sha, keyed by (component, kind)."""
+    shas = [r['sync_sha'] for r in history if r['branch'] == branch and r['chip'] == chip and r['sync_sha'] != sync_sha]
+    if not shas:
+        return {}
+    return {(r['component'], r['kind']): r for r in history
+            if r['branch'] == branch and r['chip'] == chip and r['sync_sha'] == shas[-1]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('components', nargs='+')
+    parser.add_argument('--chip', required=True)
+    parser.add_argument('--branch', required=True)
+    parser.add_argument('--sync-sha', required=True)
+    parser.add_argument('--idf-path', help='Tree with the prebuilt libraries (submodules checked out)')
+    parser.add_argument('--project-description', help='project_description.json of a build of the components')
+    parser.add_argument('--history', required=True, help='CSV history, the new rows are appended to it')
+    parser.add_argument('--threshold', type=int, default=1024, help='Increase in bytes to flag (default: 1024)')
+    parser.add_argument('--report', help='Append the flagged increases to this file')
+    args = parser.parse_args()
+
+    built = {}
+    if args.project_description:
+        with open(args.project_description) as f:
+            built = json.load(f)['build_component_info']
+
+    rows = []
+    date = datetime.datetime.now(datetime.timezone.utc).strftime('%Y-%m-%d')
+    for component in args.components:
+        libs = {}
+        if args.idf_path:
+            libs['prebuilt'] = prebuilt_libraries(args.idf_path, component, args.chip)
+        if component in built and built[component].get('file'):
+            libs['built'] = [built[component]['file']]
+
+        for kind, paths in libs.items():
+            if paths:
+                sizes = library_size(paths)
+                rows.append(dict(date=date, branch=args.branch, sync_sha=args.sync_sha, chip=args.chip,
+                                 component=component, kind=kind, **sizes))
+
+    history = read_history(args.history)
+    previous = previous_rows(history, args.branch, args.sync_sha, args.chip)
+
+    print('%-20s %-8s %10s %10s %10s %10s' % ('component', 'kind', 'text', 'rodata', 'iram', 'dram'))
+    flagged = []
+    for row in rows:
+        print('%-20s %-8s %10d %10d %10d %10d' % tuple(row[k] for k in ['component', 'kind'] + CATEGORIES))
+
+        prev = previous.get((row['component'], row['kind']))
+        if not prev:
+            continue
+        deltas = {
+            'IRAM': row['iram'] - int(prev['iram']),
+            'flash': row['text'] + row['rodata'] - int(prev['text']) - int(prev['rodata']),
+        }
+        for region, delta in deltas.items():
+            if delta > args.threshold:
+                flagged.append('%s %s (%s): %s grew by %d bytes since %s' %
+                               (args.chip, row['component'], row['kind'], region, delta, prev['sync_sha']))
+
+    new_file = not os.path.exists(args.history)
+    with open(args.history, 'a') as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS)
+        if new_file:
+            writer.writeheader()
+        writer.writerows(rows)
+
+    for line in flagged:
+        print('WARNING: ' + line)
+    if flagged and args.report:
+        with open(args.report, 'a') as f:
+            f.write('\n'.join(flagged) + '\n')
+
+
+if __name__ == '__main__':
+    main()
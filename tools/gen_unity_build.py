@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+
+"""
+Generate unity (jumbo) translation units for the hal and soc sources of a chip.
+
+Each component gets a <component>_unity.c including its sources, except the ones
+that can't share a translation unit with the others: sources whose file-scope
+static symbols, types or macros clash with another source, and sources defining
+macros before their first #include (they configure the headers). When a
+compile_commands.json is given, the unity files are also compiled and any source
+the compiler complains about is excluded too.
+
+unity.mk and unity.cmake list, per component, the unity file plus the excluded
+sources, to replace the per-file source lists of NuttX and Zephyr builds:
+
+  ESP_HAL_UNITY_HAL_SRCS / ESP_HAL_UNITY_SOC_SRCS
+
+With --measure, the compile time and object size of the unity files are compared
+with the per-file build of the same sources.
+"""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+from collections import defaultdict
+
+COMMENT_OR_LITERAL_RE = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\\n])*"|\'(?:\\.|[^\'\\\n])*\'', re.S)
+DIRECTIVE_RE = re.compile(r'^[ \t]*#[ \t]*(\w+)[ \t]*(\w*)', re.M)
+IDENT_RE = re.compile(r'\b[A-Za-z_]\w*\b')
+STATIC_RE = re.compile(r'\bstatic\b[^;{}()]*?\b([A-Za-z_]\w*)\s*[(\[=;,]')
+# __attribute__((...)) and the IDF attribute macros (IRAM_ATTR, FORCE_INLINE_ATTR, ...)
+ATTRIBUTE_RE = re.compile(r'\b__attribute__\s*\(\((?:[^()]|\([^()]*\))*\)\)|\b\w+_ATTR\b')
+TYPEDEF_RE = re.compile(r'\btypedef\b[^;]*?\b([A-Za-z_]\w*)\s*;')
+TAG_RE = re.compile(r'\b(?:struct|union|enum)\s+([A-Za-z_]\w*)\s*\{')
+DEPFILE_ARG_FLAGS = ('-MF', '-MT', '-MQ')
+ERROR_RE = re.compile(r'^(?:In file included from )?([^:\s]+\.c):\d+', re.M)
+
+KEYWORDS = {
+    'auto', 'char', 'const', 'double', 'float', 'inline', 'int', 'long', 'short', 'signed',
+    'static', 'struct', 'union', 'enum', 'unsigned', 'void', 'volatile', 'bool',
+}
+
+
+class Source:
+    def __init__(self, path):
+        self.path = path
+        with open(path, errors='replace') as f:
+            text = f.read().replace('\\\n', '')
+        code = COMMENT_OR_LITERAL_RE.sub(lambda m: ' ' if m.group(0).startswith('/') else '""', text)
+
+        self.tokens = set(IDENT_RE.findall(code))
+
+        # Macros still defined at the end of the file leak into the following sources
+        self.macros = set()
+        self.configures_headers = False
+        seen_include = False
+        for directive, name in DIRECTIVE_RE.findall(code):
+            if directive == 'include':
+                seen_include = True
+            elif directive == 'define':
+                self.macros.add(name)
+                if not seen_include:
+                    self.configures_headers = True
+            elif directive == 'undef':
+                self.macros.discard(name)
+
+        top = ATTRIBUTE_RE.sub(' ', top_level(DIRECTIVE_RE.sub('', code)))
+        self.statics = set(STATIC_RE.findall(top)) - KEYWORDS
+        self.types = set(TYPEDEF_RE.findall(top)) | set(TAG_RE.findall(top))
+
+
+def top_level(code):
+    """Drop everything between braces, keeping the braces."""
+    out = []
+    depth = 0
+    for c in code:
+        if c == '{':
+            if depth == 0:
+                out.append(c)
+            depth += 1
+        elif c == '}':
+            depth = max(depth - 1, 0)
+            if depth == 0:
+                out.append(c)
+        elif depth == 0:
+            out.append(c)
+    return ''.join(out)
+
+
+def conflict(src, members):
+    """Return why src can't join the members, or None."""
+    if src.configures_headers:
+        return 'defines macros before its first #include'
+    for other in members:
+        name = next(iter(src.statics & other.tokens or other.statics & src.tokens), None)
+        if name:
+            return 'static symbol %s clashes with %s' % (name, other.path)
+        name = next(iter(src.types & other.types), None)
+        if name:
+            return 'type %s also defined in %s' % (name, other.path)
+        name = next(iter(src.macros & other.tokens or other.macros & src.tokens), None)
+        if name:
+            return 'macro %s clashes with %s' % (name, other.path)
+    return None
+
+
+class CompileDb:
+    def __init__(self, path):
+        with open(path) as f:
+            self.entries = {os.path.realpath(os.path.join(e['directory'], e['file'])): e for e in json.load(f)}
+
+    def command(self, source, output, template=None):
+        """Return (args, directory) compiling source to output, with the flags of template if given."""
+        entry = self.entries[os.path.realpath(template or source)]
+        args = entry['arguments'] if 'arguments' in entry else shlex.split(entry['command'])
+        out = []
+        it = iter(args)
+        for arg in it:
+            if arg == '-o':
+                next(it)
+                out += ['-o', output]
+            elif arg in DEPFILE_ARG_FLAGS:
+                # Writing the dependency files would overwrite the ones of the real build
+                next(it)
+            elif arg in ('-MD', '-MMD') or arg.startswith(DEPFILE_ARG_FLAGS):
+                pass
+            elif os.path.realpath(os.path.join(entry['directory'], arg)) == os.path.realpath(entry['file']):
+                out.append(source)
+            else:
+                out.append(arg)
+        return out, entry['directory']
+
+    def compile(self, source, output, template=None):
+        args, directory = self.command(source, output, template)
+        start = time.monotonic()
+        proc = subprocess.run(args, cwd=directory, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                              universal_newlines=True)
+        return proc.returncode, proc.stdout, time.monotonic() - start
+
+
+def object_size(db, source, obj):
+    """Return text + data + bss of obj, using the size tool matching the compiler of source."""
+    compiler = db.command(source, obj)[0][0]
+    size_tool = re.sub(r'(clang|gcc|cc)$', lambda m: 'llvm-size' if m.group(1) == 'clang' else 'size', compiler)
+    out = subprocess.check_output([size_tool, obj], universal_newlines=True).splitlines()
+    text, data, bss = out[1].split()[:3]
+    return int(text) + int(data) + int(bss)
+
+
+def find_sources(root, components, db):
+    """Return the sources of the components compiled in db."""
+    sources = defaultdict(list)
+    for component in components:
+        comp_dir = os.path.realpath(os.path.join(root, 'components', component))
+        sources[component] = sorted(p for p in db.entries if p.startswith(comp_dir + os.sep))
+    return sources
+
+
+def split_sources(paths, components, root):
+    sources = defaultdict(list)
+    for path in paths:
+        path = os.path.realpath(path)
+        for component in components:
+            if path.startswith(os.path.realpath(os.path.join(root, 'components', component)) + os.sep):
+                sources[component].append(path)
+                break
+        else:
+            sys.exit('%s is not a source of %s' % (path, ', '.join(components)))
+    return sources
+
+
+def write_unity(path, chip, members):
+    with open(path, 'w') as f:
+        f.write('/* Unity build of %d sources for %s, generated by gen_unity_build.py */\n\n' % (len(members), chip))
+        for src in members:
+            f.write('#include "%s"\n' % src.path)
+
+
+def build_unity(component, chip, paths, output, db, log):
+    """Write the unity file of a component. Return (members, {excluded path: reason})."""
+    members = []
+    excluded = {}
+    for src in (Source(p) for p in paths):
+        reason = conflict(src, members)
+        if reason:
+            excluded[src.path] = reason
+        else:
+            members.append(src)
+
+    unity = os.path.join(output, '%s_unity.c' % component)
+    write_unity(unity, chip, members)
+
+    while db and members:
+        with tempfile.TemporaryDirectory() as tmp:
+            ret, out, _ = db.compile(unity, os.path.join(tmp, 'unity.o'), members[0].path)
+        if ret == 0:
+            break
+        # Blame the first source the diagnostics point to
+        by_path = {m.path: m for m in members}
+        mentioned = [by_path[p] for p in map(os.path.realpath, ERROR_RE.findall(out)) if p in by_path]
+        culprit = mentioned[0] if mentioned else members[-1]
+        log.write('%s_unity.c failed to compile:\n%s\n' % (component, out))
+        excluded[culprit.path] = 'fails to compile in the unity build'
+        members.remove(culprit)
+        write_unity(unity, chip, members)
+
+    return members, excluded
+
+
+def measure(component, members, output, db):
+    """Return (per-file seconds, per-file size, unity seconds, unity size)."""
+    unity = os.path.join(output, '%s_unity.c' % component)
+    per_file_time = per_file_size = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for i, src in enumerate(members):
+            obj = os.path.join(tmp, '%d.o' % i)
+            ret, out, elapsed = db.compile(src.path, obj)
+            if ret != 0:
+                sys.exit(out)
+            per_file_time += elapsed
+            per_file_size += object_size(db, src.path, obj)
+
+        obj = os.path.join(tmp, 'unity.o')
+        ret, out, unity_time = db.compile(unity, obj, members[0].path)
+        if ret != 0:
+            sys.exit(out)
+        unity_size = object_size(db, members[0].path, obj)
+    return per_file_time, per_file_size, unity_time, unity_size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('sources', nargs='*',
+                        help='Sources to build (default: the ones in --compile-commands)')
+    parser.add_argument('--root', default='.', help='Root of the synced tree (containing components/)')
+    parser.add_argument('--chip', required=True)
+    parser.add_argument('--output', required=True, help='Directory for the unity files and the source lists')
+    parser.add_argument('--components', nargs='+', default=['hal', 'soc'])
+    parser.add_argument('--compile-commands', help='compile_commands.json used to verify (and measure) the unity files')
+    parser.add_argument('--measure', action='store_true', help='Compare with the per-file build (needs --compile-commands)')
+    args = parser.parse_args()
+
+    if args.measure and not args.compile_commands:
+        parser.error('--measure needs --compile-commands')
+    # Which sources a chip builds depends on its SOC capabilities and Kconfig options
+    if not args.sources and not args.compile_commands:
+        parser.error('either the sources or --compile-commands must be given')
+
+    db = CompileDb(args.compile_commands) if args.compile_commands else None
+    if args.sources:
+        sources = split_sources(args.sources, args.components, args.root)
+    else:
+        sources = find_sources(args.root, args.components, db)
+
+    os.makedirs(args.output, exist_ok=True)
+    output = os.path.abspath(args.output)
+    mk = ['# Unity build sources for %s, generated by gen_unity_build.py' % args.chip]
+    cmake = list(mk)
+
+    with open(os.path.join(output, 'unity_build.log'), 'w') as log:
+        for component in args.components:
+            members, excluded = build_unity(component, args.chip, sources[component], output, db, log)
+            srcs = [os.path.join(output, '%s_unity.c' % component)] + sorted(excluded)
+            var = 'ESP_HAL_UNITY_%s_SRCS' % component.upper()
+            mk.append('%s = %s' % (var, ' '.join(srcs)))
+            cmake.append('set(%s %s)' % (var, ' '.join('"%s"' % s for s in srcs)))
+
+            print('%s: %d sources in the unity build, %d excluded' % (component, len(members), len(excluded)))
+            for path, reason in sorted(excluded.items()):
+                print('  excluded %s: %s' % (os.path.relpath(path, args.root),
+                                              reason.replace(os.path.realpath(args.root) + os.sep, '')))
+
+            if args.measure and members:
+                per_file_time, per_file_size, unity_time, unity_size = measure(component, members, output, db)
+                print('  compile time: %.2fs per-file, %.2fs unity (%.0f%%)' %
+                      (per_file_time, unity_time, 100.0 * unity_time / per_file_time))
+                print('  object size: %d bytes per-file, %d bytes unity (%+d)' %
+                      (per_file_size, unity_size, unity_size - per_file_size))
+
+    with open(os.path.join(output, 'unity.mk'), 'w') as f:
+        f.write('\n'.join(mk) + '\n')
+    with open(os.path.join(output, 'unity.cmake'), 'w') as f:
+        f.write('\n'.join(cmake) + '\n')
+
+
+if __name__ == '__main__':
+    main()
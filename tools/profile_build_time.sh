@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Compile components of an IDF tree for one chip with clang's -ftime-trace, and
+# report the time per component, translation unit, header and include chain.
+#
+# Usage: tools/profile_build_time.sh IDF_PATH CHIP OUT_DIR COMPONENTS...
+#
+# OUT_DIR receives report.txt and report.json (see tools/build_time_report.py).
+
+set -e
+
+TOOLS_DIR=$(dirname "$(realpath "$0")")
+
+. "${TOOLS_DIR}/artifacts.sh"
+
+IDF_DIR=$(realpath "$1")
+CHIP=$2
+OUT_DIR=$3
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+# The default granularity (500us) hides most of the headers
+PROJECT_COMPILE_OPTIONS="-ftime-trace -ftime-trace-granularity=50" \
+    mkproject "${WORK_DIR}/project" "${@:4}"
+
+python3 "${IDF_DIR}/tools/idf_tools.py" install esp-clang > /dev/null
+
+# Profile whatever got compiled, even if clang can't build every component
+IDF_TOOLCHAIN=clang idf_build "${IDF_DIR}" "${WORK_DIR}/project" "${CHIP}" || \
+    echo "Build failed for ${CHIP}, the report only covers the compiled translation units"
+
+mkdir -p "${OUT_DIR}"
+python3 "${TOOLS_DIR}/build_time_report.py" --json "${OUT_DIR}/report.json" \
+    "${WORK_DIR}/project/build" > "${OUT_DIR}/report.txt"
+cat "${OUT_DIR}/report.txt"
@@ -0,0 +1,85 @@
+#!/bin/bash
+
+# Check the publish/fetch round trip of tools/artifacts.sh against a stand-in
+# artifact store in a temporary directory, and build a program against the
+# fetched library and headers with the host compiler (CC, default: cc).
+#
+# Usage: tools/test_artifacts.sh
+
+set -e
+
+TOOLS_DIR=$(dirname "$(realpath "$0")")
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+. "${TOOLS_DIR}/artifacts.sh"
+
+export ARTIFACT_STORE="${WORK_DIR}/store"
+
+SYNC_SHA=0123456789abcdef0123456789abcdef01234567
+CHIP=esp32c3
+
+# Usage: fail MESSAGE
+fail() {
+    echo "FAIL: $1" >&2
+    exit 1
+}
+
+# Build, pack and publish a library, laid out like build_hal_artifacts does
+mkdir -p "${WORK_DIR}/hal-${CHIP}/lib" "${WORK_DIR}/hal-${CHIP}/include/hal/include/hal"
+echo "int gpio_hal_level(int pin);" > "${WORK_DIR}/hal-${CHIP}/include/hal/include/hal/gpio_hal.h"
+cat > "${WORK_DIR}/gpio_hal.c" << EOF
+#include "hal/gpio_hal.h"
+int gpio_hal_level(int pin) { return pin + 1; }
+EOF
+${CC:-cc} -I "${WORK_DIR}/hal-${CHIP}/include/hal/include" -c "${WORK_DIR}/gpio_hal.c" -o "${WORK_DIR}/gpio_hal.o"
+ar rcs "${WORK_DIR}/hal-${CHIP}/lib/libhal.a" "${WORK_DIR}/gpio_hal.o"
+tar -C "${WORK_DIR}" -czf "${WORK_DIR}/hal-${CHIP}.tar.gz" "hal-${CHIP}"
+store_put "${WORK_DIR}/hal-${CHIP}.tar.gz" "$(hal_artifact_path ${SYNC_SHA} ${CHIP} "$(config_hash)")"
+
+# Hit
+"${TOOLS_DIR}/artifacts.sh" fetch ${SYNC_SHA} ${CHIP} "${WORK_DIR}/hit" ||
+    fail "fetch of a published artifact failed"
+[ -f "${WORK_DIR}/hit/lib/libhal.a" ] || fail "lib/ not extracted"
+[ -f "${WORK_DIR}/hit/include/hal/include/hal/gpio_hal.h" ] || fail "include/ not extracted"
+
+# Consume the fetched artifacts
+cat > "${WORK_DIR}/main.c" << EOF
+#include "hal/gpio_hal.h"
+int main(void) { return gpio_hal_level(41) == 42 ? 0 : 1; }
+EOF
+${CC:-cc} -I "${WORK_DIR}/hit/include/hal/include" "${WORK_DIR}/main.c" \
+    -L "${WORK_DIR}/hit/lib" -lhal -o "${WORK_DIR}/main" || fail "can't build against the fetched artifacts"
+"${WORK_DIR}/main" || fail "the fetched library doesn't work"
+
+# Misses
+if "${TOOLS_DIR}/artifacts.sh" fetch 1111111111111111111111111111111111111111 ${CHIP} "${WORK_DIR}/miss" 2> /dev/null; then
+    fail "fetch of an unknown SHA succeeded"
+fi
+if "${TOOLS_DIR}/artifacts.sh" fetch ${SYNC_SHA} esp32s3 "${WORK_DIR}/miss" 2> /dev/null; then
+    fail "fetch of an unknown chip succeeded"
+fi
+
+# The configuration is part of the key
+echo "CONFIG_LOG_DEFAULT_LEVEL_NONE=y" > "${WORK_DIR}/sdkconfig.defaults"
+if [ "$("${TOOLS_DIR}/artifacts.sh" config-hash)" == "$("${TOOLS_DIR}/artifacts.sh" config-hash "${WORK_DIR}/sdkconfig.defaults")" ]; then
+    fail "config-hash ignores the sdkconfig defaults"
+fi
+if "${TOOLS_DIR}/artifacts.sh" fetch ${SYNC_SHA} ${CHIP} "${WORK_DIR}/miss" "${WORK_DIR}/sdkconfig.defaults" 2> /dev/null; then
+    fail "fetch with different sdkconfig defaults succeeded"
+fi
+
+# A missing defaults file must not fall back to the stock defaults
+if "${TOOLS_DIR}/artifacts.sh" config-hash "${WORK_DIR}/missing.defaults" > /dev/null 2>&1; then
+    fail "config-hash of a missing defaults file succeeded"
+fi
+if "${TOOLS_DIR}/artifacts.sh" fetch ${SYNC_SHA} ${CHIP} "${WORK_DIR}/miss" "${WORK_DIR}/missing.defaults" 2> /dev/null; then
+    fail "fetch with a missing defaults file succeeded"
+fi
+
+# Nothing is published without a store
+if ARTIFACT_STORE="" store_put "${WORK_DIR}/hal-${CHIP}.tar.gz" test/test 2> /dev/null; then
+    fail "store_put without ARTIFACT_STORE succeeded"
+fi
+
+echo "All artifact store tests passed"
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+
+"""
+Check how tools/footprint.py counts the sections of the static libraries.
+
+Usage: tools/test_footprint.py
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.realpath(__file__)))
+
+from footprint import SHF_EXECINSTR, category  # noqa: E402
+
+CASES = [
+    # (section, executable, category)
+    ('.iram1.5', True, 'iram'),
+    ('.iram0.text', True, 'iram'),
+    ('.wifi0iram.12', True, 'iram'),
+    ('.wifirxiram.3', True, 'iram'),
+    ('.wifislprxiram.1', True, 'iram'),
+    ('.wifislpiram.7', True, 'iram'),
+    ('.wifiextrairam.2', True, 'iram'),
+    ('.wifiorslpiram.4', True, 'iram'),
+    ('.phyiram.9', True, 'iram'),
+    ('.coexiram.1', True, 'iram'),
+    ('.coexsleepiram.6', True, 'iram'),
+    ('.text.load_iram', True, 'text'),
+    ('.text.iram_check', True, 'text'),
+    ('.text', True, 'text'),
+    ('.literal.foo', True, 'text'),
+    ('.dram1.3', False, 'dram'),
+    ('.dram0.bss', False, 'dram'),
+    ('.data.foo', False, 'dram'),
+    ('.sdata', False, 'dram'),
+    ('.bss.bar', False, 'dram'),
+    ('.sbss', False, 'dram'),
+    ('.rodata.str1.1', False, 'rodata'),
+    ('.srodata.cst4', False, 'rodata'),
+    ('.rodata.dram_table', False, 'rodata'),
+    ('.eh_frame', False, None),
+]
+
+
+def main():
+    failures = 0
+    for name, executable, expected in CASES:
+        got = category(name, SHF_EXECINSTR if executable else 0)
+        if got != expected:
+            print('FAIL: %s counted as %s, expected %s' % (name, got, expected))
+            failures += 1
+    if failures:
+        sys.exit('%d of %d sections miscounted' % (failures, len(CASES)))
+    print('All %d sections counted as expected' % len(CASES))
+
+
+if __name__ == '__main__':
+    main()
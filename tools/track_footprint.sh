@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# Record the per-component footprint of a sync head for every chip, in a history
+# kept in the artifact store, and flag the components that grew (see
+# tools/footprint.py).
+#
+# Usage: tools/track_footprint.sh IDF_PATH SYNC_BRANCH SYNC_SHA OUT_DIR COMPONENTS...
+#
+# IDF_PATH is the unfiltered tree the sync head comes from, with submodules.
+# OUT_DIR receives footprint.csv (the updated history) and, if any, flagged.txt.
+
+set -e
+
+TOOLS_DIR=$(dirname "$(realpath "$0")")
+
+. "${TOOLS_DIR}/artifacts.sh"
+
+IDF_DIR=$(realpath "$1")
+SYNC_BRANCH=$2
+SYNC_SHA=$3
+OUT_DIR=$4
+HISTORY="${OUT_DIR}/footprint.csv"
+HISTORY_PATH="footprint/${SYNC_BRANCH//\//_}/footprint.csv"
+
+mkdir -p "${OUT_DIR}"
+store_get "${HISTORY_PATH}" "${HISTORY}" || {
+    rm -f "${HISTORY}"
+    echo "No footprint history for ${SYNC_BRANCH}, starting a new one"
+}
+
+# Scheduled pipelines usually sync the same head again
+if [ -f "${HISTORY}" ] && grep -q ",${SYNC_SHA}," "${HISTORY}"; then
+    echo "Footprint of ${SYNC_SHA} already recorded"
+    exit 0
+fi
+
+WORK_DIR=
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+for CHIP in ${FOOTPRINT_CHIPS:-${HAL_ARTIFACT_CHIPS}}
+do
+    WORK_DIR=$(mktemp -d)
+
+    mkproject "${WORK_DIR}/project" "${@:5}"
+    DESC_ARG=()
+    if idf_build "${IDF_DIR}" "${WORK_DIR}/project" "${CHIP}"; then
+        DESC_ARG=(--project-description "${WORK_DIR}/project/build/project_description.json")
+    else
+        echo "Failed to build for ${CHIP}, only recording the prebuilt libraries"
+    fi
+
+    python3 "${TOOLS_DIR}/footprint.py" --chip "${CHIP}" --branch "${SYNC_BRANCH}" --sync-sha "${SYNC_SHA}" \
+        --idf-path "${IDF_DIR}" "${DESC_ARG[@]}" --history "${HISTORY}" \
+        --threshold "${FOOTPRINT_THRESHOLD:-1024}" --report "${OUT_DIR}/flagged.txt" "${@:5}"
+
+    rm -rf "${WORK_DIR}"
+done
+
+if [ -n "${ARTIFACT_STORE}" ]; then
+    store_put "${HISTORY}" "${HISTORY_PATH}"
+fi